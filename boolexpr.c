@@ -27,6 +27,7 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <limits.h>
 
 #include "boolexpr.h"
 
@@ -122,9 +123,15 @@ static const token_t token_info[] = {
     { "||",     BEXPR_OR,       BEXPR_BINARY,       BEXPR_LTR,      1 }
 };
 
-/** \brief  Valid characters in a token's text */
-static const int token_chars[] = {
-    '(', ')', '!', '&', '|', '0', '1', 'a', 'e', 'f', 'l', 'r', 's', 't', 'u'
+/** \brief  Valid characters in a token's text
+ *
+ * Indexed by character, so checking a character takes a single lookup instead
+ * of a scan of all valid characters.
+ */
+static const bool token_chars[UCHAR_MAX + 1] = {
+    ['('] = true, [')'] = true, ['!'] = true, ['&'] = true, ['|'] = true,
+    ['0'] = true, ['1'] = true, ['a'] = true, ['e'] = true, ['f'] = true,
+    ['l'] = true, ['r'] = true, ['s'] = true, ['t'] = true, ['u'] = true
 };
 
 /** \brief  Error messages */
@@ -137,14 +144,12 @@ static const char *error_messages[] = {
     "expected right parenthesis",
     "unmatched parentheses",
     "expression is empty",
-    "missing operand"
+    "missing operand",
+    "missing operator",
+    "can't add infix tokens to a postfix expression"
 };
 /* }}} */
 
-/** \brief  Copy of text fed to tokenizer with bexpr_parse()
- */
-static char *infix_text = NULL;
-
 /** \brief  Tokenized infix expression
  *
  * Input for the infix to postfix conversion.
@@ -153,11 +158,21 @@ static token_list_t infix_tokens = TLIST_INIT;
 
 /** \brief  Token stack
  *
- * Stack used for operators during postfix to infix conversion, and for
- * operands during postfix expression evaluation.
+ * Stack used for operators during postfix to infix conversion.
  */
 static token_list_t stack = TLIST_INIT;
 
+/** \brief  Operand stack
+ *
+ * Stack of boolean values used during postfix expression evaluation. Sized to
+ * the length of the postfix expression, which is the maximum stack depth, so
+ * the evaluation loop never has to check for or perform a resize.
+ */
+static bool *operands = NULL;
+
+/** \brief  Number of elements available in \c operands */
+static size_t operands_size = 0;
+
 /** \brief  Token queue
  *
  * Queue used for output during postfix to infix conversion, and as input
@@ -165,6 +180,30 @@ static token_list_t stack = TLIST_INIT;
  */
 static token_list_t queue = TLIST_INIT;
 
+/** \brief  Postfix expression in \c queue is up to date
+ *
+ * Set after a successful conversion of \c infix_tokens, cleared whenever the
+ * infix expression changes, so evaluating the same expression more than once
+ * doesn't rerun the conversion.
+ */
+static bool postfix_valid = false;
+
+/** \brief  Operand stack depth after evaluating the postfix expression
+ *
+ * Only meaningful when \c postfix_valid is set, -1 means the depth hasn't been
+ * determined yet. Used to validate tokens appended to the postfix expression
+ * without having to scan the existing expression.
+ */
+static int postfix_depth = -1;
+
+/** \brief  Expression only exists in postfix form
+ *
+ * Set when the expression was imported, appended to or parsed as postfix
+ * text. There are no infix tokens to add to in that case, so adding infix
+ * tokens is refused until bexpr_reset() is called.
+ */
+static bool postfix_only = false;
+
 /** \brief  Error code */
 int bexpr_errno = 0;
 
@@ -258,13 +297,14 @@ static void lib_free(void *ptr)
 /** \brief  Skip whitespace in string
  *
  * \param[in]   s   string
+ * \param[in]   end end of \a s (one past the last character)
  *
- * \return  pointer to first non-whitepace character (can be the terminating
- *          nul character if \a s consists of only whitespace)
+ * \return  pointer to first non-whitepace character (can be \a end if \a s
+ *          consists of only whitespace)
  */
-static const char *skip_whitespace(const char *s)
+static const char *skip_whitespace(const char *s, const char *end)
 {
-    while (*s != '\0' && isspace((unsigned char)*s)) {
+    while (s < end && isspace((unsigned char)*s)) {
         s++;
     }
     return s;
@@ -278,12 +318,7 @@ static const char *skip_whitespace(const char *s)
  */
 static bool is_token_char(int ch)
 {
-    for (size_t i = 0; i < ARRAY_LEN(token_chars); i++) {
-        if (token_chars[i] == ch) {
-            return true;
-        }
-    }
-    return false;
+    return token_chars[(unsigned char)ch];
 }
 
 /** \brief  Determine if token ID is valid
@@ -317,13 +352,14 @@ static bool is_operand(int id)
            ((id == BEXPR_FALSE) || (id == BEXPR_TRUE));
 }
 
-/** \brief  Parse text for a valid token
+/** \brief  Parse text for a valid token, limited to a text range
  *
- * Parse \a text looking for a valid token text, and if found return the ID.
- * A pointer to the first non-valid character in \a text is stored in \a endptr
- * if \a endptr isn't \c NULL.
+ * Parse \a text up to \a end looking for a valid token text, and if found
+ * return the ID. A pointer to the first non-valid character in \a text is
+ * stored in \a endptr if \a endptr isn't \c NULL.
  *
  * \param[in]   text    text to parse
+ * \param[in]   end     end of \a text (one past the last character)
  * \param[out]  endptr  location in \a text of first non-token character
  *
  * \return  token ID or \c BEXPR_INVALID on error
@@ -331,13 +367,13 @@ static bool is_operand(int id)
  * \throw   BEXPR_ERR_EXPECTED_TOKEN
  * \throw   BEXPR_ERR_INVALID_TOKEN
  */
-int bexpr_token_parse(const char *text, const char **endptr)
+static int token_parse(const char *text, const char *end, const char **endptr)
 {
     const char *pos;
     size_t      tlen;
 
-    pos = text = skip_whitespace(text);
-    while (*pos != '\0' && is_token_char(*pos)) {
+    pos = text = skip_whitespace(text, end);
+    while (pos < end && is_token_char(*pos)) {
         pos++;
     }
     if (pos - text == 0) {
@@ -369,40 +405,37 @@ int bexpr_token_parse(const char *text, const char **endptr)
     return BEXPR_INVALID;
 }
 
-/** \brief  Get pointer to element in token info array
+/** \brief  Parse text for a valid token
  *
- * \param[in]   id  token ID
+ * Parse \a text looking for a valid token text, and if found return the ID.
+ * A pointer to the first non-valid character in \a text is stored in \a endptr
+ * if \a endptr isn't \c NULL.
  *
- * \return  token info array element or \c NULL when not found
- */
-static const token_t *token_get(int id)
-{
-    if (is_valid_token_id(id)) {
-        return &token_info[id];
-    }
-    return NULL;
-}
-
-/** \brief  Get bool value from token
+ * \param[in]   text    text to parse
+ * \param[out]  endptr  location in \a text of first non-token character
  *
- * \param[in]   token   token
+ * \return  token ID or \c BEXPR_INVALID on error
  *
- * \return  \c true if \a token is \c BEXPR_TRUE
+ * \throw   BEXPR_ERR_EXPECTED_TOKEN
+ * \throw   BEXPR_ERR_INVALID_TOKEN
  */
-static bool token_to_bool(const token_t *token)
+int bexpr_token_parse(const char *text, const char **endptr)
 {
-    return (bool)(token->id == BEXPR_TRUE);
+    return token_parse(text, text + strlen(text), endptr);
 }
 
-/** \brief  Get token for boolean value
+/** \brief  Get pointer to element in token info array
  *
- * \param[in]   value   boolean value
+ * \param[in]   id  token ID
  *
- * \return  pointer to token representing \a value
+ * \return  token info array element or \c NULL when not found
  */
-static const token_t *token_from_bool(bool value)
+static const token_t *token_get(int id)
 {
-    return token_get(value ? BEXPR_TRUE : BEXPR_FALSE);
+    if (is_valid_token_id(id)) {
+        return &token_info[id];
+    }
+    return NULL;
 }
 /* }}} */
 
@@ -606,8 +639,11 @@ void bexpr_init(void)
     token_list_init(&infix_tokens);
     token_list_init(&stack);
     token_list_init(&queue);
-    infix_text  = NULL;
-    bexpr_errno = 0;
+    operands      = NULL;
+    operands_size = 0;
+    postfix_valid = false;
+    postfix_only  = false;
+    bexpr_errno   = 0;
 }
 
 
@@ -622,12 +658,12 @@ void bexpr_init(void)
  */
 void bexpr_reset(void)
 {
-    lib_free(infix_text);
-    infix_text  = NULL;
     token_list_reset(&infix_tokens);
     token_list_reset(&stack);
     token_list_reset(&queue);
-    bexpr_errno = 0;
+    postfix_valid = false;
+    postfix_only  = false;
+    bexpr_errno   = 0;
 }
 
 
@@ -656,22 +692,36 @@ void bexpr_print(void)
  */
 void bexpr_free(void)
 {
-    lib_free(infix_text);
     token_list_free(&infix_tokens);
     token_list_free(&stack);
     token_list_free(&queue);
+    lib_free(operands);
+    operands      = NULL;
+    operands_size = 0;
 }
 
 
 /** \brief  Add token to expression
+ *
+ * Tokens can't be added to an expression that only exists in postfix form,
+ * that is after bexpr_postfix_import(), bexpr_postfix_append() or
+ * bexpr_tokenize_postfix(); call bexpr_reset() first.
  *
  * \param[in]   id  token ID
  *
- * \return  \c false if token \a id is invalid
+ * \return  \c false if token \a id is invalid or the expression is postfix
+ *
+ * \throw   BEXPR_ERR_INVALID_TOKEN
+ * \throw   BEXPR_ERR_POSTFIX_ONLY
  */
 bool bexpr_token_add(int id)
 {
+    if (postfix_only) {
+        SET_ERROR(BEXPR_ERR_POSTFIX_ONLY);
+        return false;
+    }
     if (token_list_push_id(&infix_tokens, id)) {
+        postfix_valid = false;
         return true;
     } else {
         SET_ERROR(BEXPR_ERR_INVALID_TOKEN);
@@ -691,29 +741,56 @@ bool bexpr_token_add(int id)
  */
 bool bexpr_tokenize(const char *text)
 {
-    size_t len;
+    return bexpr_tokenize_n(text, strlen(text));
+}
 
-    text = skip_whitespace(text);
-    len  = strlen(text);
 
-    /* make copy of input text */
-    infix_text = lib_malloc(len + 1u);
-    memcpy(infix_text, text, len + 1u);
+/** \brief  Generate expression from a string of given length
+ *
+ * Like bexpr_tokenize(), but parse at most \a len characters of \a text, so
+ * \a text doesn't need to be nul-terminated. This allows tokenizing a part of
+ * a larger buffer (a line in a file, a C++ \c std::string_view) without first
+ * copying it into a nul-terminated string. The text itself isn't copied or
+ * referenced after returning either, only the recognized token IDs are kept.
+ *
+ * Fails with \c BEXPR_ERR_POSTFIX_ONLY if the current expression only exists
+ * in postfix form, see bexpr_token_add().
+ *
+ * \param[in]   text    string to tokenize
+ * \param[in]   len     length of \a text
+ *
+ * \return  \c true on success
+ */
+bool bexpr_tokenize_n(const char *text, size_t len)
+{
+    const char *end = text + len;
+
+    if (postfix_only) {
+        SET_ERROR(BEXPR_ERR_POSTFIX_ONLY);
+        return false;
+    }
 
     //printf("%s(): parsing '%s':\n", __func__, text);
 
-    while (*text != '\0') {
+    while (text < end) {
         const char *endptr;
         int         token;
 
-        text  = skip_whitespace(text);
-        token = bexpr_token_parse(text, &endptr);
+        text  = skip_whitespace(text, end);
+        if (text == end) {
+            /* trailing whitespace */
+            break;
+        }
+        token = token_parse(text, end, &endptr);
         //printf("%s(): token ID: %d\n", __func__, token);
         if (token == BEXPR_INVALID) {
             /* error code already set */
             return false;
         }
-        bexpr_token_add(token);
+        if (!bexpr_token_add(token)) {
+            /* error code already set */
+            return false;
+        }
         text = endptr;
     }
     return true;
@@ -833,83 +910,157 @@ static bool infix_to_postfix(void)
  * \param[out]  result  result of expression
  *
  * \return  \c true on success
+ *
+ * \throw   BEXPR_ERR_INVALID_TOKEN
+ * \throw   BEXPR_ERR_MISSING_OPERAND
+ * \throw   BEXPR_ERR_MISSING_OPERATOR
  */
 static bool eval_postfix(bool *result)
 {
-    int  index;
-    int  length;
-    const token_t *token;
+    int    index;
+    int    length;
+    size_t depth = 0;   /* number of values on the operand stack */
 
-    /* reset stack for use as operand stack */
-    token_list_reset(&stack);
+    /* make sure the operand stack can hold the deepest possible expression */
+    length = token_list_length(&queue);
+    if (operands_size < (size_t)length) {
+        operands_size = (size_t)length;
+        operands      = lib_realloc(operands, sizeof *operands * operands_size);
+    }
 
     /* iterate queue containing postfix expression and try to evaluate it */
-    length = token_list_length(&queue);
     for (index = 0; index < length; index++) {
-        token = token_list_token_at(&queue, index);
-
-//        bexpr_debug("token %d = %s\n", index, token->text);
-        if (is_operand(token->id)) {
-//            bexpr_debug("operand, pusing onto the stack: ");
-
-            token_list_push(&stack, token);
-#ifdef DEBUG_BEXPR
-        //    token_list_print(&stack);
-         //   putchar('\n');
-#endif
-        } else {
-            /* operator, pull argument(s) from stack */
-            const token_t *arg1;
-            const token_t *arg2 = NULL;
-
-            bool b1 = false;
-            bool b2 = false;
-            bool res;
-
-            arg1 = token_list_pull(&stack);
-            if (arg1 == NULL) {
-                SET_ERROR(BEXPR_ERR_MISSING_OPERAND);
-                return false;
-            }
-            //printf("%s(): arg1 = %s\n", __func__, arg1->text);
-            b1 = token_to_bool(arg1);
-
-            if (token->arity == BEXPR_BINARY) {
-                /* binary operator, pull another argument */
-                arg2 = token_list_pull(&stack);
-                if (arg2 == NULL) {
+        const token_t *token = queue.tokens[index];
+
+        switch (token->id) {
+            case BEXPR_FALSE:
+                operands[depth++] = false;
+                break;
+            case BEXPR_TRUE:
+                operands[depth++] = true;
+                break;
+            case BEXPR_NOT:
+                if (depth < 1u) {
                     SET_ERROR(BEXPR_ERR_MISSING_OPERAND);
                     return false;
                 }
-                b2 = token_to_bool(arg2);
-            }
-
-            switch (token->id) {
-                case BEXPR_NOT:
-                    res = !b1;
-                    break;
-                case BEXPR_AND:
-                    res = b1 && b2;
-                    break;
-                case BEXPR_OR:
-                    res = b1 || b2;
-                    break;
-                default:
-                    SET_ERROR(BEXPR_ERR_INVALID_TOKEN);
+                operands[depth - 1u] = !operands[depth - 1u];
+                break;
+            case BEXPR_AND:
+                if (depth < 2u) {
+                    SET_ERROR(BEXPR_ERR_MISSING_OPERAND);
                     return false;
-            }
-            token_list_push(&stack, token_from_bool(res));
+                }
+                depth--;
+                operands[depth - 1u] = operands[depth - 1u] && operands[depth];
+                break;
+            case BEXPR_OR:
+                if (depth < 2u) {
+                    SET_ERROR(BEXPR_ERR_MISSING_OPERAND);
+                    return false;
+                }
+                depth--;
+                operands[depth - 1u] = operands[depth - 1u] || operands[depth];
+                break;
+            default:
+                SET_ERROR(BEXPR_ERR_INVALID_TOKEN);
+                return false;
         }
     }
 
     /* final result should be on the stack */
-    token = token_list_pull(&stack);
-    if (token == NULL) {
+    if (depth == 0) {
         SET_ERROR(BEXPR_ERR_MISSING_OPERAND);   /* illegal expression/syntax error? */
         return false;
     }
+    /* and it should be the only value left */
+    if (depth > 1u) {
+        SET_ERROR(BEXPR_ERR_MISSING_OPERATOR);
+        return false;
+    }
 
-    *result = token_to_bool(token);
+    *result = operands[depth - 1u];
+    return true;
+}
+
+
+/** \brief  Update operand stack depth for a postfix token
+ *
+ * Update \a depth for evaluating \a token, checking if the operands required
+ * by \a token are available.
+ *
+ * \param[in]       token   token
+ * \param[in,out]   depth   operand stack depth
+ *
+ * \return  \c true on success
+ *
+ * \throw   BEXPR_ERR_MISSING_OPERAND
+ */
+static bool postfix_depth_update(const token_t *token, int *depth)
+{
+    if (is_operand(token->id)) {
+        (*depth)++;
+    } else {
+        if (*depth < token->arity) {
+            SET_ERROR(BEXPR_ERR_MISSING_OPERAND);
+            return false;
+        }
+        *depth -= token->arity - 1;
+    }
+    return true;
+}
+
+/** \brief  Make sure the postfix expression is up to date
+ *
+ * Convert the infix expression to postfix, unless the expression didn't change
+ * since the last conversion or was imported as postfix.
+ *
+ * \return  \c true on success
+ *
+ * \throw   BEXPR_ERR_EMPTY_EXPRESSION
+ */
+static bool postfix_update(void)
+{
+    if (!postfix_valid) {
+        if (token_list_length(&infix_tokens) <= 0) {
+            SET_ERROR(BEXPR_ERR_EMPTY_EXPRESSION);
+            return false;
+        }
+        if (!infix_to_postfix()) {
+            /* error code already set */
+            return false;
+        }
+        postfix_valid = true;
+        postfix_depth = -1;
+    }
+    return true;
+}
+
+/** \brief  Add token to end of postfix expression
+ *
+ * Validate token \a id against the postfix expression and add it to the end of
+ * the expression when valid. \c postfix_depth must be known.
+ *
+ * \param[in]   id  token ID
+ *
+ * \return  \c true on success
+ *
+ * \throw   BEXPR_ERR_INVALID_TOKEN
+ * \throw   BEXPR_ERR_MISSING_OPERAND
+ */
+static bool postfix_push_id(int id)
+{
+    const token_t *token = token_get(id);
+
+    if (token == NULL || token->id == BEXPR_LPAREN || token->id == BEXPR_RPAREN) {
+        SET_ERROR(BEXPR_ERR_INVALID_TOKEN);
+        return false;
+    }
+    if (!postfix_depth_update(token, &postfix_depth)) {
+        /* error code already set */
+        return false;
+    }
+    token_list_enqueue(&queue, token);
     return true;
 }
 
@@ -919,6 +1070,9 @@ static bool eval_postfix(bool *result)
  * Evaluate boolean expression, either obtained by bexpr_parse() or by adding
  * tokens with bexpr_add_token().
  *
+ * The expression is converted to postfix only once: evaluating it again
+ * without changing it reuses the previously converted expression.
+ *
  * \param[out]  result  result of evaluation
  *
  * \return  \c true on succes
@@ -928,22 +1082,266 @@ bool bexpr_evaluate(bool *result)
     *result = false;
     bexpr_errno = 0;
 
-    if (token_list_length(&infix_tokens) <= 0) {
-        SET_ERROR(BEXPR_ERR_EMPTY_EXPRESSION);
+    /* convert infix expression to postfix expression if required */
+    if (!postfix_update()) {
+        /* error code already set */
         return false;
     }
 
-    /* convert infix expression to postfix expression */
-    if (!infix_to_postfix()) {
+    /* try to evaluate the postfix expression in the queue */
+    if (!eval_postfix(result)) {
         /* error code already set */
         return false;
     }
 
-    /* try to evaluate the postfix expression in the queue */
-    if (!eval_postfix(result)) {
+    return true;
+}
+
+
+/** \brief  Export postfix expression as array of token IDs
+ *
+ * Convert the current expression to postfix (if not done already) and store
+ * at most \a size token IDs of the postfix expression in \a ids. The exported
+ * expression can later be restored with bexpr_postfix_import() without having
+ * to tokenize and convert the original text again.
+ *
+ * Passing \c NULL for \a ids and \c 0 for \a size can be used to obtain the
+ * number of tokens required.
+ *
+ * \param[out]  ids     token IDs of the postfix expression
+ * \param[in]   size    number of elements available in \a ids
+ *
+ * \return  number of tokens in the postfix expression, or -1 on error
+ *
+ * \throw   BEXPR_ERR_EMPTY_EXPRESSION
+ */
+int bexpr_postfix_export(int *ids, int size)
+{
+    int length;
+
+    if (!postfix_update()) {
+        /* error code already set */
+        return -1;
+    }
+
+    length = token_list_length(&queue);
+    for (int i = 0; i < length && i < size; i++) {
+        ids[i] = token_list_token_at(&queue, i)->id;
+    }
+    return length;
+}
+
+
+/** \brief  Import postfix expression from array of token IDs
+ *
+ * Replace the current expression with the postfix expression in \a ids, as
+ * obtained by bexpr_postfix_export(). The expression is validated: all IDs
+ * must be operands or operators, each operator must have its operands
+ * available and the expression must reduce to exactly one value. After a
+ * successful import the expression can be evaluated with bexpr_evaluate()
+ * directly.
+ *
+ * \param[in]   ids     token IDs of postfix expression
+ * \param[in]   count   number of elements in \a ids
+ *
+ * \return  \c true on success
+ *
+ * \throw   BEXPR_ERR_EMPTY_EXPRESSION
+ * \throw   BEXPR_ERR_INVALID_TOKEN
+ * \throw   BEXPR_ERR_MISSING_OPERAND
+ * \throw   BEXPR_ERR_MISSING_OPERATOR
+ */
+bool bexpr_postfix_import(const int *ids, int count)
+{
+    token_list_reset(&infix_tokens);
+    token_list_reset(&queue);
+    postfix_valid = false;
+    postfix_only  = false;
+    postfix_depth = 0;
+
+    if (count <= 0) {
+        SET_ERROR(BEXPR_ERR_EMPTY_EXPRESSION);
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!postfix_push_id(ids[i])) {
+            /* error code already set */
+            token_list_reset(&queue);
+            return false;
+        }
+    }
+    /* the expression must reduce to exactly one value */
+    if (postfix_depth != 1) {
+        SET_ERROR(BEXPR_ERR_MISSING_OPERATOR);
+        token_list_reset(&queue);
+        return false;
+    }
+
+    postfix_valid = true;
+    postfix_only  = true;
+    return true;
+}
+
+
+/** \brief  Append postfix tokens to the current expression
+ *
+ * Append the postfix tokens in \a ids to the current expression, converting
+ * the current expression to postfix first if required. Since postfix
+ * expressions compose by concatenation, this allows building new expressions
+ * from already converted ones without tokenizing or converting text again:
+ * appending an exported expression followed by \c BEXPR_AND yields the logical
+ * AND of both expressions, appending just \c BEXPR_NOT negates the current
+ * expression. The combined expression must reduce to exactly one value, so an
+ * expression and the operator combining it must be appended in a single call.
+ *
+ * Only the appended tokens are validated, the cost doesn't depend on the size
+ * of the current expression. On error the current expression is left intact.
+ *
+ * After a successful append the expression only exists in postfix form: adding
+ * infix tokens with bexpr_token_add() or bexpr_tokenize() fails until
+ * bexpr_reset() is called.
+ *
+ * \param[in]   ids     token IDs of postfix tokens
+ * \param[in]   count   number of elements in \a ids
+ *
+ * \return  \c true on success
+ *
+ * \throw   BEXPR_ERR_EMPTY_EXPRESSION
+ * \throw   BEXPR_ERR_INVALID_TOKEN
+ * \throw   BEXPR_ERR_MISSING_OPERAND
+ * \throw   BEXPR_ERR_MISSING_OPERATOR
+ */
+bool bexpr_postfix_append(const int *ids, int count)
+{
+    int saved_index;
+    int saved_depth;
+
+    if (!postfix_update()) {
         /* error code already set */
         return false;
     }
 
+    /* determine stack depth of an expression converted from infix */
+    if (postfix_depth < 0) {
+        int depth = 0;
+
+        for (int i = 0; i < token_list_length(&queue); i++) {
+            if (!postfix_depth_update(queue.tokens[i], &depth)) {
+                /* error code already set */
+                return false;
+            }
+        }
+        postfix_depth = depth;
+    }
+
+    saved_index = queue.index;
+    saved_depth = postfix_depth;
+    for (int i = 0; i < count; i++) {
+        if (!postfix_push_id(ids[i])) {
+            /* error code already set, restore previous expression */
+            queue.index   = saved_index;
+            postfix_depth = saved_depth;
+            return false;
+        }
+    }
+    /* the combined expression must reduce to exactly one value */
+    if (postfix_depth != 1) {
+        SET_ERROR(BEXPR_ERR_MISSING_OPERATOR);
+        queue.index   = saved_index;
+        postfix_depth = saved_depth;
+        return false;
+    }
+
+    /* the postfix expression no longer corresponds to the infix tokens */
+    token_list_reset(&infix_tokens);
+    postfix_only = true;
+    return true;
+}
+
+
+/** \brief  Generate postfix expression from a string of given length
+ *
+ * Like bexpr_tokenize_postfix(), but parse at most \a len characters of
+ * \a text, so \a text doesn't need to be nul-terminated.
+ *
+ * \param[in]   text    string to tokenize
+ * \param[in]   len     length of \a text
+ *
+ * \return  \c true on success
+ *
+ * \throw   BEXPR_ERR_EMPTY_EXPRESSION
+ * \throw   BEXPR_ERR_EXPECTED_TOKEN
+ * \throw   BEXPR_ERR_INVALID_TOKEN
+ * \throw   BEXPR_ERR_MISSING_OPERAND
+ * \throw   BEXPR_ERR_MISSING_OPERATOR
+ */
+bool bexpr_tokenize_postfix_n(const char *text, size_t len)
+{
+    const char *end = text + len;
+
+    token_list_reset(&infix_tokens);
+    token_list_reset(&queue);
+    postfix_valid = false;
+    postfix_only  = false;
+    postfix_depth = 0;
+
+    while (true) {
+        const char *endptr;
+        int         token;
+
+        text = skip_whitespace(text, end);
+        if (text == end) {
+            break;
+        }
+        token = token_parse(text, end, &endptr);
+        if (token == BEXPR_INVALID || !postfix_push_id(token)) {
+            /* error code already set */
+            token_list_reset(&queue);
+            return false;
+        }
+        text = endptr;
+    }
+
+    if (token_list_is_empty(&queue)) {
+        SET_ERROR(BEXPR_ERR_EMPTY_EXPRESSION);
+        return false;
+    }
+    /* the expression must reduce to exactly one value */
+    if (postfix_depth != 1) {
+        SET_ERROR(BEXPR_ERR_MISSING_OPERATOR);
+        token_list_reset(&queue);
+        return false;
+    }
+    postfix_valid = true;
+    postfix_only  = true;
     return true;
 }
+
+
+/** \brief  Generate postfix expression from a string
+ *
+ * Parse \a text containing an expression in postfix notation ("reverse polish
+ * notation"), for example "true false ! &&". The tokens are added directly to
+ * the postfix expression, skipping the infix to postfix conversion, and are
+ * validated while parsing: each operator must have its operands available and
+ * the expression must leave exactly one value on the operand stack.
+ * Parentheses are not valid in postfix notation.
+ *
+ * After a successful call the expression can be evaluated with
+ * bexpr_evaluate().
+ *
+ * \param[in]   text    string to tokenize
+ *
+ * \return  \c true on success
+ *
+ * \throw   BEXPR_ERR_EMPTY_EXPRESSION
+ * \throw   BEXPR_ERR_EXPECTED_TOKEN
+ * \throw   BEXPR_ERR_INVALID_TOKEN
+ * \throw   BEXPR_ERR_MISSING_OPERAND
+ * \throw   BEXPR_ERR_MISSING_OPERATOR
+ */
+bool bexpr_tokenize_postfix(const char *text)
+{
+    return bexpr_tokenize_postfix_n(text, strlen(text));
+}
@@ -25,6 +25,11 @@
 #define BOOLEXPR_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /* Token IDs
  *
@@ -52,6 +57,8 @@ enum {
     BEXPR_ERR_UNMATCHED_PARENS, /**< unmatched parenthesis */
     BEXPR_ERR_EMPTY_EXPRESSION, /**< empty expression */
     BEXPR_ERR_MISSING_OPERAND,  /**< missing operand for operator */
+    BEXPR_ERR_MISSING_OPERATOR, /**< operands left without operator */
+    BEXPR_ERR_POSTFIX_ONLY,     /**< infix tokens added to postfix expression */
 
     BEXPR_ERROR_COUNT
 };
@@ -68,6 +75,18 @@ void bexpr_print(void);
 int  bexpr_token_parse(const char *text, const char **endptr);
 bool bexpr_token_add  (int token);
 bool bexpr_tokenize   (const char *text);
+bool bexpr_tokenize_n (const char *text, size_t len);
 bool bexpr_evaluate   (bool *result);
 
+int  bexpr_postfix_export(int *ids, int size);
+bool bexpr_postfix_import(const int *ids, int count);
+bool bexpr_postfix_append(const int *ids, int count);
+
+bool bexpr_tokenize_postfix  (const char *text);
+bool bexpr_tokenize_postfix_n(const char *text, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,61 @@
+/** \file   boolexpr.hpp
+ * \brief   Boolean expression evaluation - C++ header
+ *
+ * Overloads of the tokenizer functions taking \c std::string_view, forwarding
+ * to the length-bounded C functions so the text doesn't need to be copied into
+ * a nul-terminated string. Requires C++17.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/* Copyright (C) 2023  Bas Wassink
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef BOOLEXPR_HPP
+#define BOOLEXPR_HPP
+
+#include <string_view>
+
+#include "boolexpr.h"
+
+/** \brief  Generate expression from a string view
+ *
+ * \param[in]   text    string to tokenize
+ *
+ * \return  \c true on success
+ *
+ * \see bexpr_tokenize_n()
+ */
+inline bool bexpr_tokenize(std::string_view text)
+{
+    return bexpr_tokenize_n(text.data(), text.size());
+}
+
+/** \brief  Generate postfix expression from a string view
+ *
+ * \param[in]   text    string to tokenize
+ *
+ * \return  \c true on success
+ *
+ * \see bexpr_tokenize_postfix_n()
+ */
+inline bool bexpr_tokenize_postfix(std::string_view text)
+{
+    return bexpr_tokenize_postfix_n(text.data(), text.size());
+}
+
+#endif
@@ -20,6 +20,9 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+/* clock_gettime() */
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,13 +30,53 @@
 #include <errno.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "boolexpr.h"
 
 
-/** \brief  Buffer used for reading and parsing lines of the input file
+/** \brief  Initial size of the buffer input files are read into */
+#define READ_INITIAL_SIZE   65536u
+
+/** \brief  Size of the stdio buffer of the decision log */
+#define LOG_BUFFER_SIZE 65536u
+
+/** \brief  Decision log file header
+ *
+ * Written once at the start of the decision log. Fields are stored in native
+ * byte order, so a log written on a machine with different endianness fails
+ * the version and record size checks.
+ */
+typedef struct log_header_s {
+    char     magic[4];      /**< \c LOG_MAGIC */
+    uint16_t version;       /**< \c LOG_VERSION */
+    uint16_t record_size;   /**< size of a record in bytes */
+} log_header_t;
+
+/** \brief  Decision log magic number */
+#define LOG_MAGIC       "BXLG"
+
+/** \brief  Decision log format version */
+#define LOG_VERSION     1u
+
+/** \brief  Decision log record
+ *
+ * Fixed-size record written to the decision log for each test.
  */
-static char line[256];
+typedef struct log_record_s {
+    uint64_t time;      /**< time of evaluation in nanoseconds since the epoch */
+    uint32_t lineno;    /**< line number of the test in its file */
+    uint16_t file;      /**< index of the test file, 0 is the first */
+    int8_t   errnum;    /**< value of \c bexpr_errno after the test */
+    uint8_t  flags;     /**< bit 0: result of evaluation, bit 1: test passed */
+} log_record_t;
+
+/** \brief  Decision log record flag: result of evaluation was \c true */
+#define LOG_FLAG_RESULT 0x01u
+
+/** \brief  Decision log record flag: test passed */
+#define LOG_FLAG_PASSED 0x02u
 
 /** \brief  Basename portion of argv[0]
  */
@@ -42,6 +85,14 @@ static char *prgname;
 static int total_tests;
 static int passed_tests;
 
+/** \brief  Decision log file, \c NULL when not logging */
+static FILE *logfile;
+
+/** \brief  Index of the file currently being parsed among the test files on
+ *          the command line, starting at 0
+ */
+static int file_index;
+
 
 /** \brief  Print usage message on stdout
  *
@@ -49,7 +100,10 @@ static int passed_tests;
  */
 static void usage(void)
 {
-    printf("Usage: %s <filename>\n", prgname);
+    printf("Usage: %s [--log <logfile>] <filename> [<filename> ...]\n"
+           "       %s --dump-log <logfile>\n"
+           "       %s --api-test\n",
+           prgname, prgname, prgname);
 }
 
 /** \brief  Print I/O error number and message on stderr
@@ -63,6 +117,54 @@ static void print_ioerror(void)
             prgname, errno, strerror(errno));
 }
 
+/** \brief  Read contents of file into memory
+ *
+ * Read all of \a fp into a single heap-allocated buffer, using as few read
+ * calls as possible. The buffer is doubled in size whenever it's full, so the
+ * total amount of copying done by realloc(3) stays linear in the file size.
+ * The buffer is nul-terminated.
+ *
+ * \param[in]   fp  file to read
+ *
+ * \return  file contents, free with \c free(3), or \c NULL on error
+ */
+static char *read_file(FILE *fp)
+{
+    char   *buffer = NULL;
+    size_t  size   = 0;
+    size_t  length = 0;
+
+    while (true) {
+        size_t nread;
+
+        if (length == size) {
+            char *tmp;
+
+            size = size == 0 ? READ_INITIAL_SIZE : size * 2u;
+            tmp  = realloc(buffer, size + 1u);
+            if (tmp == NULL) {
+                print_ioerror();
+                free(buffer);
+                return NULL;
+            }
+            buffer = tmp;
+        }
+
+        nread   = fread(buffer + length, 1u, size - length, fp);
+        length += nread;
+        if (nread == 0) {
+            if (ferror(fp)) {
+                print_ioerror();
+                free(buffer);
+                return NULL;
+            }
+            break;
+        }
+    }
+    buffer[length] = '\0';
+    return buffer;
+}
+
 /** \brief  Skip whitespace in string
  *
  * \param[in]   s   string
@@ -84,20 +186,26 @@ static char *skip_whitespace(char *s)
  * and \a expected_result to the result of evaluation.
  *
  * \param[in]   text            expression text
+ * \param[in]   postfix         \a text is in postfix notation
  * \param[in]   expected_errnum expected error number
  * \param[in]   expected_result expected result of evaluation
+ * \param[out]  result          result of evaluation
  *
  * \return  \c true if test passed
  */
-static bool run_test(const char *text, int expected_errnum, bool expected_result)
+static bool run_test(const char *text,
+                     bool        postfix,
+                     int         expected_errnum,
+                     bool        expected_result,
+                     bool       *result)
 {
-    bool result = false;
+    *result = false;
 
     bexpr_reset();
     bexpr_errno = 0;
 
     printf("  Tokenizing: ");
-    if (bexpr_tokenize(text)) {
+    if (postfix ? bexpr_tokenize_postfix(text) : bexpr_tokenize(text)) {
         /* tokenization passed */
         printf("true: PASS\n");
     } else {
@@ -118,14 +226,14 @@ static bool run_test(const char *text, int expected_errnum, bool expected_result
     }
 
     printf("  Evaluating: ");;
-    if (bexpr_evaluate(&result)) {
+    if (bexpr_evaluate(result)) {
         /* evaluation passed */
-        if (result == expected_result) {
-            printf(" %s: PASS.\n", result ? "true" : "false");
+        if (*result == expected_result) {
+            printf(" %s: PASS.\n", *result ? "true" : "false");
             return true;
         } else {
             printf(" FAIL: result %s doesn't match expected %s\n",
-                   result ? "true" : "false",
+                   *result ? "true" : "false",
                    expected_result ? "true" : "false");
             return false;
         }
@@ -142,6 +250,330 @@ static bool run_test(const char *text, int expected_errnum, bool expected_result
 }
 
 
+/** \brief  Write record to the decision log
+ *
+ * Does nothing when no decision log was requested. Records are buffered by
+ * stdio and written in large blocks.
+ *
+ * \param[in]   lineno  line number of test
+ * \param[in]   result  result of evaluation
+ * \param[in]   passed  test passed
+ */
+static void log_decision(int lineno, bool result, bool passed)
+{
+    log_record_t    rec;
+    struct timespec now;
+
+    if (logfile == NULL) {
+        return;
+    }
+    clock_gettime(CLOCK_REALTIME, &now);
+    rec.time   = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+    rec.lineno = (uint32_t)lineno;
+    rec.file   = (uint16_t)file_index;
+    rec.errnum = (int8_t)bexpr_errno;
+    rec.flags  = (uint8_t)((result ? LOG_FLAG_RESULT : 0u) |
+                           (passed ? LOG_FLAG_PASSED : 0u));
+    if (fwrite(&rec, sizeof rec, 1u, logfile) != 1u) {
+        print_ioerror();
+    }
+}
+
+/** \brief  Open decision log for writing
+ *
+ * Open \a path for writing and write the log header.
+ *
+ * \param[in]   path    path to decision log
+ *
+ * \return  \c true on success
+ */
+static bool open_log(const char *path)
+{
+    log_header_t header;
+
+    logfile = fopen(path, "wb");
+    if (logfile == NULL) {
+        print_ioerror();
+        return false;
+    }
+    setvbuf(logfile, NULL, _IOFBF, LOG_BUFFER_SIZE);
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, LOG_MAGIC, sizeof header.magic);
+    header.version     = LOG_VERSION;
+    header.record_size = (uint16_t)sizeof(log_record_t);
+    if (fwrite(&header, sizeof header, 1u, logfile) != 1u) {
+        print_ioerror();
+        fclose(logfile);
+        logfile = NULL;
+        return false;
+    }
+    return true;
+}
+
+/** \brief  Print contents of decision log on stdout
+ *
+ * \param[in]   path    path to decision log
+ *
+ * \return  \c true on success
+ */
+static bool dump_log(const char *path)
+{
+    FILE         *fp;
+    log_header_t  header;
+    log_record_t  rec;
+    size_t        nread;
+    bool          status = true;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        print_ioerror();
+        return false;
+    }
+
+    /* check header */
+    if (fread(&header, sizeof header, 1u, fp) != 1u ||
+            memcmp(header.magic, LOG_MAGIC, sizeof header.magic) != 0 ||
+            header.version != LOG_VERSION ||
+            header.record_size != sizeof rec) {
+        fprintf(stderr, "%s: '%s' is not a decision log of a supported version.\n",
+                prgname, path);
+        fclose(fp);
+        return false;
+    }
+
+    printf("time                  file  line  errnum  result  passed\n");
+    while ((nread = fread(&rec, 1u, sizeof rec, fp)) == sizeof rec) {
+        printf("%10lu.%09lu  %4u  %4lu  %6d  %-6s  %s\n",
+               (unsigned long)(rec.time / 1000000000u),
+               (unsigned long)(rec.time % 1000000000u),
+               (unsigned int)rec.file,
+               (unsigned long)rec.lineno,
+               (int)rec.errnum,
+               (rec.flags & LOG_FLAG_RESULT) ? "true" : "false",
+               (rec.flags & LOG_FLAG_PASSED) ? "yes" : "no");
+    }
+    if (ferror(fp)) {
+        print_ioerror();
+        status = false;
+    } else if (nread != 0) {
+        fprintf(stderr, "%s: '%s': truncated record at end of log.\n",
+                prgname, path);
+        status = false;
+    }
+    fclose(fp);
+    return status;
+}
+
+
+/** \brief  Record result of API test
+ *
+ * \param[in]   desc    description of test
+ * \param[in]   passed  test passed
+ */
+static void api_check(const char *desc, bool passed)
+{
+    total_tests++;
+    if (passed) {
+        passed_tests++;
+    }
+    printf("  %s: %s\n", desc, passed ? "PASS" : "FAIL");
+}
+
+/** \brief  Test tokenizing text that isn't nul-terminated or has trailing
+ *          whitespace
+ */
+static void api_test_tokenize(void)
+{
+    /* no terminating nul character */
+    const char exact[4]     = { 't', 'r', 'u', 'e' };
+    /* the closing parentheses would fail if they were parsed */
+    const char slice[]      = "false || true)))";
+    const char postfix[]    = "true false || ((";
+    bool       result       = false;
+
+    printf("Tokenizing:\n");
+
+    bexpr_reset();
+    api_check("tokenize text without nul character",
+              bexpr_tokenize_n(exact, sizeof exact));
+    api_check("evaluate text without nul character",
+              bexpr_evaluate(&result) && result);
+
+    bexpr_reset();
+    api_check("tokenize slice of text", bexpr_tokenize_n(slice, 13u));
+    api_check("evaluate slice of text", bexpr_evaluate(&result) && result);
+
+    bexpr_reset();
+    api_check("tokenize slice of postfix text",
+              bexpr_tokenize_postfix_n(postfix, 13u));
+    api_check("evaluate slice of postfix text",
+              bexpr_evaluate(&result) && result);
+
+    bexpr_reset();
+    api_check("tokenize text with trailing whitespace",
+              bexpr_tokenize("true && false  \t\r\n"));
+    api_check("evaluate text with trailing whitespace",
+              bexpr_evaluate(&result) && !result);
+}
+
+/** \brief  Test reuse and invalidation of the converted expression
+ */
+static void api_test_conversion_cache(void)
+{
+    bool result = false;
+
+    printf("Conversion cache:\n");
+
+    bexpr_reset();
+    bexpr_tokenize("true && !false");
+    api_check("evaluate expression", bexpr_evaluate(&result) && result);
+    api_check("evaluate same expression again",
+              bexpr_evaluate(&result) && result);
+    api_check("converted expression unchanged",
+              bexpr_postfix_export(NULL, 0) == 4);
+
+    api_check("add tokens after evaluation",
+              bexpr_token_add(BEXPR_AND) && bexpr_token_add(BEXPR_FALSE));
+    api_check("evaluate reconverts updated expression",
+              bexpr_evaluate(&result) && !result);
+    api_check("converted expression includes added tokens",
+              bexpr_postfix_export(NULL, 0) == 6);
+
+    bexpr_reset();
+    bexpr_tokenize("false || true");
+    api_check("evaluate new expression after reset",
+              bexpr_evaluate(&result) && result);
+    api_check("converted expression replaced after reset",
+              bexpr_postfix_export(NULL, 0) == 3);
+}
+
+/** \brief  Test bexpr_postfix_export() and bexpr_postfix_import()
+ */
+static void api_test_export_import(void)
+{
+    int  ids[16];
+    int  count;
+    bool result = false;
+
+    printf("Postfix export and import:\n");
+
+    bexpr_reset();
+    bexpr_tokenize("!(false || false) && true");
+    api_check("query exported length", bexpr_postfix_export(NULL, 0) == 6);
+    count = bexpr_postfix_export(ids, (int)(sizeof ids / sizeof ids[0]));
+    api_check("export", count == 6);
+
+    bexpr_reset();
+    api_check("import exported expression", bexpr_postfix_import(ids, count));
+    api_check("evaluate imported expression",
+              bexpr_evaluate(&result) && result);
+
+    api_check("reject empty expression",
+              !bexpr_postfix_import(ids, 0) &&
+              bexpr_errno == BEXPR_ERR_EMPTY_EXPRESSION);
+
+    ids[0] = BEXPR_TRUE;
+    ids[1] = 42;
+    api_check("reject invalid token ID",
+              !bexpr_postfix_import(ids, 2) &&
+              bexpr_errno == BEXPR_ERR_INVALID_TOKEN);
+
+    ids[1] = BEXPR_LPAREN;
+    api_check("reject parenthesis",
+              !bexpr_postfix_import(ids, 2) &&
+              bexpr_errno == BEXPR_ERR_INVALID_TOKEN);
+
+    ids[1] = BEXPR_AND;
+    api_check("reject missing operand",
+              !bexpr_postfix_import(ids, 2) &&
+              bexpr_errno == BEXPR_ERR_MISSING_OPERAND);
+
+    ids[1] = BEXPR_FALSE;
+    api_check("reject leftover operand",
+              !bexpr_postfix_import(ids, 2) &&
+              bexpr_errno == BEXPR_ERR_MISSING_OPERATOR);
+}
+
+/** \brief  Test bexpr_postfix_append()
+ */
+static void api_test_append(void)
+{
+    int  base[]     = { BEXPR_TRUE, BEXPR_FALSE, BEXPR_OR };
+    int  override[] = { BEXPR_FALSE, BEXPR_NOT, BEXPR_FALSE, BEXPR_AND,
+                        BEXPR_AND };
+    int  not_op[]   = { BEXPR_NOT };
+    bool result     = false;
+
+    printf("Postfix append:\n");
+
+    bexpr_reset();
+    api_check("import base", bexpr_postfix_import(base, 3));
+    api_check("append expression and operator",
+              bexpr_postfix_append(override, 5));
+    api_check("evaluate combined expression",
+              bexpr_evaluate(&result) && !result);
+    api_check("append unary operator", bexpr_postfix_append(not_op, 1));
+    api_check("evaluate negated expression",
+              bexpr_evaluate(&result) && result);
+
+    api_check("reject operator without operands",
+              !bexpr_postfix_append(&override[4], 1) &&
+              bexpr_errno == BEXPR_ERR_MISSING_OPERAND);
+    api_check("reject expression without operator",
+              !bexpr_postfix_append(override, 4) &&
+              bexpr_errno == BEXPR_ERR_MISSING_OPERATOR);
+    api_check("failed append leaves expression intact",
+              bexpr_postfix_export(NULL, 0) == 9 &&
+              bexpr_evaluate(&result) && result);
+
+    bexpr_reset();
+    bexpr_tokenize("true && false");
+    api_check("append to infix expression", bexpr_postfix_append(not_op, 1));
+    api_check("evaluate appended infix expression",
+              bexpr_evaluate(&result) && result);
+
+    /* infix input can't extend an expression that only exists as postfix */
+    bexpr_reset();
+    bexpr_postfix_import(base, 1);
+    bexpr_postfix_append(not_op, 1);
+    api_check("reject infix token after append",
+              !bexpr_token_add(BEXPR_TRUE) &&
+              bexpr_errno == BEXPR_ERR_POSTFIX_ONLY);
+    api_check("reject infix text after append",
+              !bexpr_tokenize("true") &&
+              bexpr_errno == BEXPR_ERR_POSTFIX_ONLY);
+    api_check("rejected infix input leaves expression intact",
+              bexpr_evaluate(&result) && !result);
+    bexpr_reset();
+    api_check("accept infix token after reset", bexpr_token_add(BEXPR_TRUE));
+    api_check("evaluate infix expression after reset",
+              bexpr_evaluate(&result) && result);
+}
+
+/** \brief  Run tests of API functions
+ *
+ * \return  \c true if all tests passed
+ */
+static bool run_api_tests(void)
+{
+    bexpr_init();
+    total_tests  = 0;
+    passed_tests = 0;
+
+    api_test_tokenize();
+    api_test_conversion_cache();
+    api_test_export_import();
+    api_test_append();
+
+    bexpr_free();
+    printf("Passed: %d out of %d (%5.1f%%)\n",
+           passed_tests, total_tests,
+           (double)passed_tests / (double)total_tests * 100.0);
+    return passed_tests == total_tests;
+}
+
+
 /** \brief  Parse file \a path to test boolean expression handling
  *
  * \param[in]   path    path to file to parse
@@ -152,35 +584,45 @@ static bool run_test(const char *text, int expected_errnum, bool expected_result
 static bool parse_file(const char *path)
 {
     FILE    *fp;
-    int      lineno = 1;
-    bool     status = true;
+    char    *contents;
+    char    *line;
+    char    *next;
+    int      lineno  = 1;
+    bool     status  = true;
+    bool     postfix = false;   /* expressions are in postfix notation */
 
     fp = fopen(path, "rb");
     if (fp == NULL) {
         print_ioerror();
         return false;
     }
+    /* read the entire file at once and split it into lines in place */
+    contents = read_file(fp);
+    fclose(fp);
+    if (contents == NULL) {
+        return false;
+    }
 
     bexpr_init();
     total_tests  = 0;
     passed_tests = 0;
 
-    while (true) {
+    for (line = contents; *line != '\0'; line = next) {
         char *curpos;
         char *endptr;
         long  errnum_exp = 0;   /* expected error number */
         bool  result_exp = false;   /* expected result of evaluation */
+        bool  result;
+        bool  passed;
 
-        memset(line, 0, sizeof line);
-        if (fgets(line, (int)sizeof line, fp) == NULL) {
-            if (!feof(fp)) {
-                print_ioerror();
-                status = false;
-            }
-            break;
+        next = strchr(line, '\n');
+        if (next != NULL) {
+            *next++ = '\0';
+        } else {
+            next = line + strlen(line);
         }
 
-        /* trim trailing whitespace, including newline/carriage return */
+        /* trim trailing whitespace, including carriage return */
         for (int i = (int)strlen(line) - 1; i >= 0 && isspace((unsigned char)(line[i])); i--) {
             line[i] = '\0';
         }
@@ -193,6 +635,13 @@ static bool parse_file(const char *path)
             continue;
         }
 
+        /* switch notation of the following expressions */
+        if (strcmp(curpos, "%postfix") == 0 || strcmp(curpos, "%infix") == 0) {
+            postfix = (bool)(curpos[1] == 'p');
+            lineno++;
+            continue;
+        }
+
         /* get expected error number */
         errno = 0;
         errnum_exp = strtol(curpos, &endptr, 10);
@@ -226,15 +675,17 @@ static bool parse_file(const char *path)
 
         curpos = skip_whitespace(curpos);
         printf("Found test #%d at line %d:\t%s\n", total_tests + 1, lineno, curpos);
-        if (run_test(curpos, (int)errnum_exp, result_exp)) {
+        passed = run_test(curpos, postfix, (int)errnum_exp, result_exp, &result);
+        if (passed) {
             passed_tests++;
         }
+        log_decision(lineno, result, passed);
         lineno++;
         total_tests++;
     }
 cleanup:
     bexpr_free();
-    fclose(fp);
+    free(contents);
 
     if (status && total_tests >= 1) {
         printf("Passed: %d out of %d (%5.1f%%)\n",
@@ -254,6 +705,12 @@ cleanup:
  */
 int main(int argc, char *argv[])
 {
+    int status = EXIT_SUCCESS;
+    int first  = 1;     /* index of first filename in argv */
+
+    /* generate program name for messages */
+    prgname = basename(argv[0]);
+
     if (argc < 2) {
         usage();
         return EXIT_FAILURE;
@@ -263,13 +720,39 @@ int main(int argc, char *argv[])
         return EXIT_SUCCESS;
     }
 
-    /* generate program name for messages */
-    prgname = basename(argv[0]);
+    if (strcmp(argv[1], "--api-test") == 0) {
+        return run_api_tests() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    printf("Parsing '%s':\n", argv[1]);
-    if (parse_file(argv[1])) {
-        return EXIT_SUCCESS;
-    } else {
-        return EXIT_FAILURE;
+    if (strcmp(argv[1], "--dump-log") == 0) {
+        if (argc != 3) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        return dump_log(argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
     }
+
+    if (strcmp(argv[1], "--log") == 0) {
+        if (argc < 4) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        if (!open_log(argv[2])) {
+            return EXIT_FAILURE;
+        }
+        first = 3;
+    }
+
+    for (file_index = 0; file_index < argc - first; file_index++) {
+        printf("Parsing '%s':\n", argv[first + file_index]);
+        if (!parse_file(argv[first + file_index])) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if (logfile != NULL && fclose(logfile) != 0) {
+        print_ioerror();
+        status = EXIT_FAILURE;
+    }
+    return status;
 }